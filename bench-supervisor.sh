@@ -0,0 +1,17 @@
+#!/bin/sh
+# Runs the supervisor against simulated devices (gpu_burn-sim, built with
+# -DSIMDEV) and prints its CPU use, wakeup latency and report-generation
+# cost for each device count.  Reports are generated on every update (-r).
+#
+# Environment: BIN, DEVICES, SECS, LATENCY (ms per batch), JITTER (ms)
+
+BIN=${BIN:-./gpu_burn-sim}
+DEVICES=${DEVICES:-"8 16 32 64 128 256 512"}
+SECS=${SECS:-30}
+LATENCY=${LATENCY:-1000}
+JITTER=${JITTER:-100}
+
+for n in $DEVICES; do
+	echo "== $n devices, $LATENCY +- $JITTER ms per batch, $SECS s"
+	"$BIN" -s "$n,$LATENCY,$JITTER" -r "$SECS" 2>&1 >/dev/null | grep '^bench:'
+done
@@ -36,6 +36,7 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstdarg>
 #include <cerrno>
 #include <string>
 #include <map>
@@ -46,15 +47,147 @@
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <fcntl.h>
 #include <fstream>
 
+#ifndef SIMDEV
 #include <cuda.h>
 #include "cublas_v2.h"
+#else
+#include <climits>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
 
 static bool tty_output;
 static double usemem = USEMEM;
 static char *progname;
 
+// Timeline trace in Chrome trace-event JSON (opens in Perfetto / chrome://tracing).
+// The supervisor and every client append to the same O_APPEND file.  Each
+// process keeps its own fixed buffer of complete event lines and hands it to
+// a single write() when it fills up or once a second, so memory stays bounded
+// and the file is only touched about once a second per process.
+#define TRACE_BUFSIZE 65536
+#define TRACE_MAXEVENT 512
+#define TRACE_FLUSH_USEC 1000000.0
+#define TRACE_TID_BURN 0
+#define TRACE_TID_SUPERVISOR 1
+
+static int traceFd = -1;
+static char traceBuf[TRACE_BUFSIZE];
+static size_t traceLen = 0;
+static size_t traceDone = 0; // Bytes of traceBuf already written out
+static double traceLastFlush = 0.0;
+static volatile sig_atomic_t traceStopped = 0;
+
+// Microseconds on the monotonic clock, which all processes share
+double traceNow() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec * 1000000.0 + (double)t.tv_nsec / 1000.0;
+}
+
+// Writes out the rest of traceBuf, returns false on an error
+bool traceWrite() {
+	while (traceDone < traceLen) {
+		ssize_t n = write(traceFd, traceBuf + traceDone, traceLen - traceDone);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		traceDone += n;
+	}
+	return true;
+}
+
+void traceFlush() {
+	if (traceFd < 0)
+		return;
+	// A failed write may have left half a line in the file; appending more
+	// would only bury it, so give up on the trace
+	if (!traceWrite()) {
+		fprintf(stderr, "Couldn't write trace, disabling it: %s\n", strerror(errno));
+		close(traceFd);
+		traceFd = -1;
+	}
+	traceLen = 0;
+	traceDone = 0;
+	traceLastFlush = traceNow();
+}
+
+// Appends one event line.  Events that don't fit TRACE_MAXEVENT are dropped
+// rather than truncated, as that would leave the file unparseable.
+void traceEvent(double now, const char *fmt, ...) {
+	if (traceFd < 0)
+		return;
+
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(traceBuf + traceLen, TRACE_MAXEVENT, fmt, args);
+	va_end(args);
+	if (n > 0 && n < TRACE_MAXEVENT)
+		traceLen += n;
+
+	if (traceLen + TRACE_MAXEVENT > TRACE_BUFSIZE || now - traceLastFlush > TRACE_FLUSH_USEC)
+		traceFlush();
+}
+
+void traceSpan(int dev, const char *name, double start, double end, const char *argName, long long argValue) {
+	traceEvent(end, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"%s\":%lld}},\n",
+			name, start, end - start, dev, TRACE_TID_BURN, argName, argValue);
+}
+
+void traceInstant(int dev, int tid, const char *name, const char *argName, long long argValue) {
+	double now = traceNow();
+	traceEvent(now, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"%s\":%lld}},\n",
+			name, now, dev, tid, argName, argValue);
+}
+
+void traceCounter(int dev, const char *name, const char *unit, double value) {
+	double now = traceNow();
+	traceEvent(now, "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%d,\"args\":{\"%s\":%.2f}},\n",
+			name, now, dev, unit, value);
+}
+
+void traceOpen(const char *fileName) {
+	traceFd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (traceFd < 0)
+		throw std::string("Couldn't open trace file ") + fileName + ": " + strerror(errno);
+	traceLastFlush = traceNow();
+	traceEvent(traceLastFlush, "[\n");
+	traceFlush();
+}
+
+// Only the supervisor closes the array, after all clients have exited
+void traceClose() {
+	if (traceFd < 0)
+		return;
+	traceEvent(traceNow(), "{\"name\":\"end\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}\n]\n",
+			traceNow(), TRACE_TID_SUPERVISOR);
+	traceFlush();
+	close(traceFd);
+	traceFd = -1;
+}
+
+// Clients are stopped with SIGTERM by the supervisor, or with SIGINT by
+// Ctrl-C; write out what they have buffered first.  traceBuf only ever holds
+// complete lines up to traceLen.
+void traceTerm(int sig) {
+	if (traceFd >= 0)
+		traceWrite();
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+// The supervisor's SIGINT/SIGTERM handler.  It ends the run the same way as
+// reaching the run length, so that the clients get to flush and the trace
+// is closed, which matters most for infinite runs.
+void traceStop(int sig) {
+	traceStopped = 1;
+}
+
+#ifndef SIMDEV
 void checkError(int rCode, std::string desc = "") {
 	static std::map<int, std::string> g_errorStrings;
 	if (!g_errorStrings.size()) {
@@ -218,6 +351,11 @@ template <class T> class GPU_Test {
 							&beta,
 							(float*)d_Cdata + i*SIZE*SIZE, SIZE), "SGEMM");
 		}
+
+		// The GEMMs are asynchronous; wait for them so that the traced
+		// compute span covers the GPU work rather than just the enqueueing
+		if (traceFd >= 0)
+			checkError(cuCtxSynchronize(), "Sync");
 	}
 
 	void initCompareKernel() {
@@ -290,13 +428,103 @@ int initCuda() {
 	return deviceCount;
 }
 
+#else // SIMDEV
+
+// Simulated devices, for running the supervisor without GPUs (make
+// gpu_burn-sim).  A batch takes simLatency +- simJitter ms and finds errors
+// with probability simFaultRate.  With probability simFailRate it fails the
+// way a CUDA error does, reporting -1 to the supervisor, and with probability
+// simCrashRate the client dies abruptly, as on a segfault or the OOM killer.
+#define SIM_ITERS 100
+
+static int simDevices = 8;
+static double simLatency = 1000.0;
+static double simJitter = 0.0;
+static double simFaultRate = 0.0;
+static double simFailRate = 0.0;
+static double simCrashRate = 0.0;
+static bool simReportAll = false;
+// Per-device rings of send times indexed by message number, shared with the
+// supervisor which uses them to measure its wakeup latency.  A client blocks
+// once its pipe is full (64 KiB, 8192 messages), so it can't lap its ring.
+#define SIM_RING 16384
+static double *simSendTime;
+
+template <class T> class GPU_Test {
+	public:
+	GPU_Test(int dev, bool doubles) : d_doubles(doubles), d_devNumber(dev), d_iters(SIM_ITERS), d_sent(0), d_error(0) {
+		d_seed = (unsigned int)(dev + 1);
+	}
+
+	unsigned long long int getErrors() {
+		unsigned long long int tempErrs = d_error;
+		d_error = 0;
+		return tempErrs;
+	}
+
+	size_t getIters() {
+		return d_iters;
+	}
+
+	void initBuffers(T *A, T *B) {
+		printf("Initialized simulated device %d, %.1f +- %.1f ms per batch, %s\n",
+				d_devNumber, simLatency, simJitter, d_doubles ? "using DOUBLES" : "using FLOATS");
+	}
+
+	void compute() {
+		double ms = simLatency + simJitter * (2.0 * uniform() - 1.0);
+		if (ms > 0.0) {
+			struct timespec t;
+			t.tv_sec = (time_t)(ms / 1000.0);
+			t.tv_nsec = (long)((ms - (double)t.tv_sec * 1000.0) * 1000000.0);
+			nanosleep(&t, NULL);
+		}
+		if (uniform() < simFailRate)
+			throw std::string("Simulated device failure");
+		if (uniform() < simCrashRate)
+			raise(SIGKILL);
+	}
+
+	void compare() {
+		if (uniform() < simFaultRate)
+			d_error += 1 + rand_r(&d_seed) % 1000;
+		simSendTime[d_devNumber*SIM_RING + d_sent++ % SIM_RING] = traceNow();
+	}
+
+	private:
+	double uniform() {
+		return (double)rand_r(&d_seed) / (double)RAND_MAX;
+	}
+
+	bool d_doubles;
+	int d_devNumber;
+	size_t d_iters;
+	size_t d_sent;
+	unsigned int d_seed;
+
+	long long int d_error;
+};
+
+// Returns the number of devices
+int initCuda() {
+	return simDevices;
+}
+#endif
+
 template<class T> void startBurn(int index, int writeFd, T *A, T *B, bool doubles) {
+	if (traceFd >= 0) {
+		signal(SIGTERM, traceTerm);
+		signal(SIGINT, traceTerm);
+	}
+
 	GPU_Test<T> *our;
 	try {
 		our = new GPU_Test<T>(index, doubles);
 		our->initBuffers(A, B);
 	} catch (std::string e) {
 		fprintf(stderr, "Couldn't init a GPU test: %s\n", e.c_str());
+		traceInstant(index, TRACE_TID_BURN, "init failed", "code", 124);
+		traceFlush();
 		exit(124);
 	}
 
@@ -305,17 +533,30 @@ template<class T> void startBurn(int index, int writeFd, T *A, T *B, bool double
 	unsigned long long int errors = 0;*/
 	try {
 		while (true) {
+			double computeStart = traceNow();
 			our->compute();
+			double compareStart = traceNow();
 			our->compare();
+			double sendStart = traceNow();
 			/*errors += our->getErrors();
 			iters++;*/
 			int ops = our->getIters();
 			write(writeFd, &ops, sizeof(int));
-			ops = our->getErrors();
-			write(writeFd, &ops, sizeof(int));
+			int errors = our->getErrors();
+			write(writeFd, &errors, sizeof(int));
+
+			if (traceFd >= 0) {
+				traceSpan(index, "compute", computeStart, compareStart, "iters", ops);
+				traceSpan(index, "compare", compareStart, sendStart, "errors", errors);
+				traceSpan(index, "send", sendStart, traceNow(), "bytes", 2*sizeof(int));
+				if (errors)
+					traceInstant(index, TRACE_TID_BURN, "errors", "count", errors);
+			}
 		}
 	} catch (std::string e) {
 		fprintf(stderr, "Failure during compute: %s\n", e.c_str());
+		traceInstant(index, TRACE_TID_BURN, "compute failed", "code", 111);
+		traceFlush();
 		int ops = -1;
 		// Signalling that we failed
 		write(writeFd, &ops, sizeof(int));
@@ -333,7 +574,18 @@ int pollTemp(pid_t *p) {
 	if (!myPid) {
 		close(tempPipe[0]);
 		dup2(tempPipe[1], STDOUT_FILENO); // Stdout
-		execlp("nvidia-smi", "nvidia-smi", "-l", "5", "-q", "-d", "TEMPERATURE", NULL);
+#ifdef SIMDEV
+		// Stands in for nvidia-smi, in the same format
+		for (unsigned int seed = 1;; sleep(5))
+			for (int i = 0; i < simDevices; ++i) {
+				dprintf(STDOUT_FILENO, "        GPU Current Temp            : %d C\n", 60 + rand_r(&seed) % 20);
+				if (traceFd >= 0)
+					dprintf(STDOUT_FILENO, "        Power Draw                  : %.2f W\n", 200.0 + rand_r(&seed) % 1000 / 10.0);
+			}
+#endif
+		// Power readings are only of use in the trace
+		execlp("nvidia-smi", "nvidia-smi", "-l", "5", "-q", "-d",
+				traceFd >= 0 ? "TEMPERATURE,POWER" : "TEMPERATURE", NULL);
 		fprintf(stderr, "Could not invoke nvidia-smi, no temps available\n");
 
 		exit(0);
@@ -345,7 +597,8 @@ int pollTemp(pid_t *p) {
 	return tempPipe[0];
 }
 
-void updateTemps(int handle, std::vector<int> *temps) {
+// Returns false once nvidia-smi has exited
+bool updateTemps(int handle, std::vector<int> *temps) {
 	const int readSize = 10240;
 	static int gpuIter = 0;
 	char data[readSize+1];
@@ -360,7 +613,7 @@ void updateTemps(int handle, std::vector<int> *temps) {
 			break;
 		}
 		curPos += n;
-		if (data[curPos] == '\n') {
+		if (data[curPos-1] == '\n') {
 			curPos -= 1;
 			break;
 		}
@@ -368,16 +621,22 @@ void updateTemps(int handle, std::vector<int> *temps) {
 
 	data[curPos] = 0;
 	if (done)
-		return;
+		return false;
 
 	int tempValue;
+	float powerValue;
 	// FIXME: The syntax of this print might change in the future..
 	if (sscanf(data, "        GPU Current Temp            : %d C", &tempValue) == 1) {
 		//printf("read temp val %d\n", tempValue);
 		temps->at(gpuIter) = tempValue;
+		traceCounter(gpuIter, "temperature", "C", tempValue);
 		gpuIter = (gpuIter+1)%(temps->size());
 	} else if (!strcmp(data, "        Gpu                     : N/A"))
 		gpuIter = (gpuIter+1)%(temps->size()); // We rotate the iterator for N/A values as well
+	else if (sscanf(data, "        Power Draw                  : %f W", &powerValue) == 1)
+		// Power Readings follow the Temperature section of the same GPU
+		traceCounter((gpuIter+temps->size()-1)%(temps->size()), "power", "W", powerValue);
+	return true;
 }
 
 void listenClients(std::vector<int> clientFd, std::vector<pid_t> clientPid, int runTime) {
@@ -405,6 +664,18 @@ void listenClients(std::vector<int> clientFd, std::vector<pid_t> clientPid, int
 
 	time_t startTime = time(0);
 
+	for (size_t i = 0; i < clientFd.size(); ++i) {
+		traceEvent(traceNow(), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"GPU %d\"}},\n", (int)i, (int)i);
+		traceEvent(traceNow(), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"burn\"}},\n", (int)i, TRACE_TID_BURN);
+		traceEvent(traceNow(), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"supervisor\"}},\n", (int)i, TRACE_TID_SUPERVISOR);
+	}
+	traceFlush();
+
+	if (traceFd >= 0) {
+		signal(SIGINT, traceStop);
+		signal(SIGTERM, traceStop);
+	}
+
 	for (size_t i = 0; i < clientFd.size(); ++i) {
 		clientTemp.push_back(0);
 		clientErrors.push_back(0);
@@ -416,29 +687,64 @@ void listenClients(std::vector<int> clientFd, std::vector<pid_t> clientPid, int
 		clientFaulty.push_back(false);
 	}
 
+#ifdef SIMDEV
+	// Supervisor cost, reported at the end for bench-supervisor.sh
+	struct rusage usageStart;
+	getrusage(RUSAGE_SELF, &usageStart);
+	double benchStart = traceNow();
+	unsigned long benchWakeups = 0, benchMessages = 0, benchReports = 0;
+	double benchLatencySum = 0.0, benchLatencyMax = 0.0;
+	double benchReportSum = 0.0, benchReportMax = 0.0;
+	std::vector<size_t> benchReceived(clientFd.size(), 0);
+#endif
+
 	int changeCount;
 	float nextReport = 30.0f;
 	bool childReport = false;
 	bool done = false;
-	while (!done && (changeCount = select(maxHandle+1, &waitHandles, NULL, NULL, NULL))) {
+	while (!done && !traceStopped && (changeCount = select(maxHandle+1, &waitHandles, NULL, NULL, NULL)) > 0) {
 		time_t thisTime = time(0);
 		struct timespec thisTimeSpec;
 		clock_gettime(CLOCK_REALTIME, &thisTimeSpec);
+#ifdef SIMDEV
+		benchWakeups++;
+#endif
 
 		//printf("got new data! %d\n", changeCount);
 		// Going through all descriptors
 		for (size_t i = 0; i < clientFd.size(); ++i)
-			if (FD_ISSET(clientFd.at(i), &waitHandles)) {
-				// First, reading processed
+			if (clientFd.at(i) != -1 && FD_ISSET(clientFd.at(i), &waitHandles)) {
+				// First, reading processed, then errors.  A client that has
+				// exited leaves its pipe readable forever, so on EOF or a
+				// cut-off message we count it dead and stop listening to it
 				int processed, errors;
-				read(clientFd.at(i), &processed, sizeof(int));
-				// Then errors
-				read(clientFd.at(i), &errors, sizeof(int));
+				if (read(clientFd.at(i), &processed, sizeof(int)) != sizeof(int) ||
+						read(clientFd.at(i), &errors, sizeof(int)) != sizeof(int)) {
+					clientFd.at(i) = -1;
+					processed = -1;
+					errors = 0;
+				}
+#ifdef SIMDEV
+				// Failure messages aren't sent from compare()
+				if (processed != -1) {
+					// Send to handling, which includes serving the
+					// descriptors before this one in the same pass
+					double latency = traceNow() - simSendTime[i*SIM_RING + benchReceived.at(i)++ % SIM_RING];
+					benchLatencySum += latency;
+					if (latency > benchLatencyMax)
+						benchLatencyMax = latency;
+					benchMessages++;
+				}
+#endif
 
 				clientErrors.at(i) += errors;
-				if (processed == -1)
+				if (processed == -1) {
+					if (clientCalcs.at(i) != -1) {
+						traceInstant(i, TRACE_TID_SUPERVISOR, "died", "pid", clientPid.at(i));
+						traceFlush();
+					}
 					clientCalcs.at(i) = -1;
-				else
+				} else
 				{
 					double flops = (double)processed * (double)OPS_PER_MUL;
 					struct timespec clientPrevTime = clientUpdateTime.at(i);
@@ -452,19 +758,29 @@ void listenClients(std::vector<int> clientFd, std::vector<pid_t> clientPid, int
 				childReport = true;
 			}
 
-		if (FD_ISSET(tempHandle, &waitHandles))
-			updateTemps(tempHandle, &clientTemp);
+		// Like a dead client, an exited nvidia-smi would keep its pipe readable
+		if (tempHandle != -1 && FD_ISSET(tempHandle, &waitHandles) &&
+				!updateTemps(tempHandle, &clientTemp)) {
+			close(tempHandle);
+			tempHandle = -1;
+		}
 
 		// Resetting the listeners
 		FD_ZERO(&waitHandles);
-		FD_SET(tempHandle, &waitHandles);
+		if (tempHandle != -1)
+			FD_SET(tempHandle, &waitHandles);
 		for (size_t i = 0; i < clientFd.size(); ++i)
-			FD_SET(clientFd.at(i), &waitHandles);
+			if (clientFd.at(i) != -1)
+				FD_SET(clientFd.at(i), &waitHandles);
 
 		done = runTime == 0 ? false : (startTime + runTime <= thisTime);
 		// Printing progress (if a child has initted already)
 		if (childReport) {
 			float elapsed = (float)(thisTime-startTime);
+#ifdef SIMDEV
+			double reportStart = traceNow();
+			bool reported = tty_output || nextReport < elapsed || done;
+#endif
 			if (tty_output || nextReport < elapsed || done) {
 				if (tty_output)
 					putchar('\r');
@@ -507,11 +823,25 @@ void listenClients(std::vector<int> clientFd, std::vector<pid_t> clientPid, int
 				fflush(stdout);
 				//printf("\t(checkpoint)\n");
 				for (size_t i = 0; i < clientErrors.size(); ++i) {
-					if (clientErrors.at(i))
+					if (clientErrors.at(i)) {
+						if (!clientFaulty.at(i)) {
+							traceInstant(i, TRACE_TID_SUPERVISOR, "faulty", "errors", clientErrors.at(i));
+							traceFlush();
+						}
 						clientFaulty.at(i) = true;
+					}
 					clientErrors.at(i) = 0;
 				}
 			}
+#ifdef SIMDEV
+			if (reported) {
+				double reportTime = traceNow() - reportStart;
+				benchReportSum += reportTime;
+				if (reportTime > benchReportMax)
+					benchReportMax = reportTime;
+				benchReports++;
+			}
+#endif
 		}
 
 		// Checking whether all clients are dead
@@ -521,6 +851,7 @@ void listenClients(std::vector<int> clientFd, std::vector<pid_t> clientPid, int
 				oneAlive = true;
 		if (!oneAlive) {
 			fprintf(stderr, "\n\nNo clients are alive!  Aborting\n");
+			traceClose();
 			exit(123);
 		}
 
@@ -532,18 +863,38 @@ void listenClients(std::vector<int> clientFd, std::vector<pid_t> clientPid, int
 		kill(clientPid.at(i), 15);
 
 	kill(tempPid, 15);
-	close(tempHandle);
+	if (tempHandle != -1)
+		close(tempHandle);
 
 	while (wait(NULL) != -1);
+	traceClose();
 	printf("done\n");
 
 	printf("\nTested %d GPUs:\n", (int)clientPid.size());
 	for (size_t i = 0; i < clientPid.size(); ++i)
 		printf("\tGPU %d: %s\n", (int)i, clientFaulty.at(i) ? "FAULTY" : "OK");
+
+#ifdef SIMDEV
+	struct rusage usageEnd;
+	getrusage(RUSAGE_SELF, &usageEnd);
+	double wall = (traceNow() - benchStart) / 1000000.0;
+	double cpu = (double)(usageEnd.ru_utime.tv_sec - usageStart.ru_utime.tv_sec) +
+		(double)(usageEnd.ru_stime.tv_sec - usageStart.ru_stime.tv_sec) +
+		(double)(usageEnd.ru_utime.tv_usec - usageStart.ru_utime.tv_usec) / 1000000.0 +
+		(double)(usageEnd.ru_stime.tv_usec - usageStart.ru_stime.tv_usec) / 1000000.0;
+	fprintf(stderr, "bench: devices %d wall %.2f s cpu %.3f s (%.2f%%) wakeups %lu\n",
+			(int)clientPid.size(), wall, cpu, 100.0 * cpu / wall, benchWakeups);
+	fprintf(stderr, "bench: wakeup latency avg %.1f us max %.1f us over %lu messages\n",
+			benchMessages ? benchLatencySum / benchMessages : 0.0, benchLatencyMax, benchMessages);
+	fprintf(stderr, "bench: report generation avg %.1f us max %.1f us over %lu reports\n",
+			benchReports ? benchReportSum / benchReports : 0.0, benchReportMax, benchReports);
+#endif
 }
 
 template<class T> void launch(int runLength, bool useDoubles) {
+#ifndef SIMDEV
 	system("nvidia-smi -L");
+#endif
 
 	// Initting A and B with random data
 	T *A = (T*) malloc(sizeof(T)*SIZE*SIZE);
@@ -563,6 +914,7 @@ template<class T> void launch(int runLength, bool useDoubles) {
 	std::vector<pid_t> clientPids;
 	clientPipes.push_back(readMain);
 
+	traceFlush();
 	pid_t myPid = fork();
 	if (!myPid) {
 		// Child
@@ -627,12 +979,24 @@ void print_usage (void)
 	printf("  -d\t\t\tUse doubles instead of floats\n");
 	printf("  -m PCT\t\tUse PCT percent of available memory (default %u)\n",
 	       (unsigned)(usemem * 100.0));
+	printf("  -t FILE\t\tWrite a timeline trace (Chrome trace-event JSON) to FILE\n");
+#ifdef SIMDEV
+	printf("  -s N[,MS[,JIT[,FAULT[,FAIL[,CRASH]]]]]\n");
+	printf("\t\t\tSimulate N devices taking MS +- JIT ms per batch.  Per\n");
+	printf("\t\t\tbatch, find errors with probability FAULT, report a\n");
+	printf("\t\t\tfailure with probability FAIL and get killed without\n");
+	printf("\t\t\treporting with probability CRASH\n");
+	printf("\t\t\t(default %d,%.0f,%.0f,%g,%g,%g)\n",
+	       simDevices, simLatency, simJitter, simFaultRate, simFailRate, simCrashRate);
+	printf("  -r\t\t\tReport on every update, as on a terminal\n");
+#endif
 	printf("  -h\t\t\tPrint this help\n");
 }
 
 int main(int argc, char **argv) {
 	int runLength = 10;
 	bool useDoubles = false;
+	const char *traceFile = NULL;
 	int thisParam = 0;
 	progname = argv[0];
 	while (argc - thisParam >= 2) {
@@ -658,6 +1022,44 @@ int main(int argc, char **argv) {
 			}
 			usemem = (double)pct / 100.0;
 			thisParam += 2;
+		} else if (std::string(argv[1+thisParam]) == "-t") {
+			if (argc-thisParam < 3) {
+				fprintf(stderr, "missing argument for -t option\n");
+				print_usage();
+				return 1;
+			}
+			traceFile = argv[2+thisParam];
+			thisParam += 2;
+#ifdef SIMDEV
+		} else if (std::string(argv[1+thisParam]) == "-s") {
+			if (argc-thisParam < 3) {
+				fprintf(stderr, "missing argument for -s option\n");
+				print_usage();
+				return 1;
+			}
+			int devices = simDevices;
+			double latency = simLatency, jitter = simJitter;
+			double faultRate = simFaultRate, failRate = simFailRate, crashRate = simCrashRate;
+			if (sscanf(argv[2+thisParam], "%d,%lf,%lf,%lf,%lf,%lf",
+						&devices, &latency, &jitter, &faultRate, &failRate, &crashRate) < 1 ||
+					devices < 1 || devices > FD_SETSIZE - 16 || latency < 0.0 || jitter < 0.0 ||
+					faultRate < 0.0 || faultRate > 1.0 || failRate < 0.0 || failRate > 1.0 ||
+					crashRate < 0.0 || crashRate > 1.0) {
+				fprintf(stderr, "invalid simulation parameters: %s\n", argv[2+thisParam]);
+				print_usage();
+				return 1;
+			}
+			simDevices = devices;
+			simLatency = latency;
+			simJitter = jitter;
+			simFaultRate = faultRate;
+			simFailRate = failRate;
+			simCrashRate = crashRate;
+			thisParam += 2;
+		} else if (std::string(argv[1+thisParam]) == "-r") {
+			simReportAll = true;
+			thisParam++;
+#endif
 		} else if (*argv[1+thisParam] == '-') {
 			fprintf(stderr, "unrecognized option: %s\n", argv[1+thisParam]);
 			print_usage();
@@ -680,6 +1082,24 @@ int main(int argc, char **argv) {
 	}
 
 	tty_output = isatty(1);
+#ifdef SIMDEV
+	tty_output = tty_output || simReportAll;
+	simSendTime = (double*) mmap(NULL, sizeof(double)*simDevices*SIM_RING, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (simSendTime == MAP_FAILED) {
+		fprintf(stderr, "Couldn't map send times: %s\n", strerror(errno));
+		return 1;
+	}
+#endif
+
+	if (traceFile) {
+		try {
+			traceOpen(traceFile);
+		} catch (std::string e) {
+			fprintf(stderr, "%s\n", e.c_str());
+			return 1;
+		}
+	}
 
 	if (useDoubles)
 		launch<double>(runLength, useDoubles);